@@ -1011,6 +1011,8 @@ static void convert_ts(struct thread_stat *dst, struct thread_stat *src)
 	dst->total_submit	= le64_to_cpu(src->total_submit);
 	dst->total_complete	= le64_to_cpu(src->total_complete);
 	dst->nr_zone_resets	= le64_to_cpu(src->nr_zone_resets);
+	dst->nr_syscalls	= le64_to_cpu(src->nr_syscalls);
+	dst->zerocopy_bytes	= le64_to_cpu(src->zerocopy_bytes);
 
 	for (i = 0; i < DDIR_RWDIR_CNT; i++) {
 		dst->io_bytes[i]	= le64_to_cpu(src->io_bytes[i]);
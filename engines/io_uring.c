@@ -9,6 +9,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
+#include <pthread.h>
 #include <sys/time.h>
 #include <sys/resource.h>
 
@@ -22,6 +23,13 @@
 
 #include "../lib/types.h"
 #include "../os/linux/io_uring.h"
+#ifdef CONFIG_NVME_URING_CMD
+#include "nvme.h"
+#endif
+
+enum uring_cmd_type {
+	FIO_URING_CMD_NVME = 1,
+};
 
 struct io_sq_ring {
 	unsigned *head;
@@ -45,8 +53,23 @@ struct ioring_mmap {
 	size_t len;
 };
 
+/*
+ * Rings in the same sqthread_poll_shared group attach to the SQ poll thread
+ * of the first ring created in that group.
+ */
+struct ioring_sqpoll_group {
+	struct flist_head list;
+	unsigned int id;
+	int ring_fd;
+	int refcount;
+};
+
+static pthread_mutex_t sqpoll_group_lock = PTHREAD_MUTEX_INITIALIZER;
+static FLIST_HEAD(sqpoll_group_list);
+
 struct ioring_data {
 	int ring_fd;
+	struct ioring_sqpoll_group *sqpoll_group;
 
 	struct io_u **io_u_index;
 
@@ -57,14 +80,34 @@ struct ioring_data {
 	struct iovec *iovecs;
 	unsigned sq_ring_mask;
 
+	/*
+	 * io_uring_cmd rings use 128 byte SQEs and 32 byte CQEs, each entry
+	 * then spans two of the regular sized ones.
+	 */
+	unsigned entry_shift;
+
 	struct io_cq_ring cq_ring;
 	unsigned cq_ring_mask;
 
 	int queued;
 	int cq_ring_off;
 	unsigned iodepth;
+	unsigned ring_depth;
 
 	struct ioring_mmap mmap[3];
+
+	/*
+	 * CQE arrival rate (completions per second) for adaptive_reap,
+	 * as a running average over successive getevents calls.
+	 */
+	uint64_t cq_rate;
+	struct timespec cq_rate_time;
+
+	struct io_uring_buf_ring *buf_ring;
+	unsigned buf_ring_mask;
+	unsigned short buf_ring_tail;
+	char **bufs;
+	int *io_u_bid;
 };
 
 struct ioring_options {
@@ -76,8 +119,18 @@ struct ioring_options {
 	unsigned int sqpoll_thread;
 	unsigned int sqpoll_set;
 	unsigned int sqpoll_cpu;
+	unsigned int sqpoll_shared;
 	unsigned int nonvectored;
 	unsigned int uncached;
+	unsigned int buffer_select;
+	unsigned int cmd_type;
+	unsigned int adaptive_reap;
+};
+
+/* layout of struct __kernel_timespec */
+struct ioring_timespec {
+	int64_t tv_sec;
+	long long tv_nsec;
 };
 
 static const int ddir_to_op[2][2] = {
@@ -165,6 +218,16 @@ static struct fio_option options[] = {
 		.category = FIO_OPT_C_ENGINE,
 		.group	= FIO_OPT_G_IOURING,
 	},
+	{
+		.name	= "sqthread_poll_shared",
+		.lname	= "Shared SQ thread poll group",
+		.type	= FIO_OPT_INT,
+		.off1	= offsetof(struct ioring_options, sqpoll_shared),
+		.minval	= 1,
+		.help	= "Share one SQ poll thread between rings of this group",
+		.category = FIO_OPT_C_ENGINE,
+		.group	= FIO_OPT_G_IOURING,
+	},
 	{
 		.name	= "nonvectored",
 		.lname	= "Non-vectored",
@@ -183,18 +246,94 @@ static struct fio_option options[] = {
 		.category = FIO_OPT_C_ENGINE,
 		.group	= FIO_OPT_G_IOURING,
 	},
+	{
+		.name	= "buffer_select",
+		.lname	= "Kernel buffer selection",
+		.type	= FIO_OPT_STR_SET,
+		.off1	= offsetof(struct ioring_options, buffer_select),
+		.help	= "Let the kernel pick read buffers from a provided buffer ring",
+		.category = FIO_OPT_C_ENGINE,
+		.group	= FIO_OPT_G_IOURING,
+	},
+	{
+		.name	= "adaptive_reap",
+		.lname	= "Adaptive completion reaping",
+		.type	= FIO_OPT_INT,
+		.off1	= offsetof(struct ioring_options, adaptive_reap),
+		.help	= "Wait for completions expected within this time (usec)",
+		.is_time = 1,
+		.category = FIO_OPT_C_ENGINE,
+		.group	= FIO_OPT_G_IOURING,
+	},
+	{
+		.name	= "cmd_type",
+		.lname	= "Uring cmd type",
+		.type	= FIO_OPT_STR,
+		.off1	= offsetof(struct ioring_options, cmd_type),
+		.help	= "Specify uring-cmd type",
+		.def	= "nvme",
+		.posval = {
+			  { .ival = "nvme",
+			    .oval = FIO_URING_CMD_NVME,
+			    .help = "Issue nvme-uring-cmd",
+			  },
+		},
+		.category = FIO_OPT_C_ENGINE,
+		.group	= FIO_OPT_G_IOURING,
+	},
 	{
 		.name	= NULL,
 	},
 };
 
-static int io_uring_enter(struct ioring_data *ld, unsigned int to_submit,
-			 unsigned int min_complete, unsigned int flags)
+static inline struct io_uring_sqe *fio_ioring_sqe(struct ioring_data *ld,
+						  unsigned index)
 {
+	return &ld->sqes[index << ld->entry_shift];
+}
+
+static inline struct io_uring_cqe *fio_ioring_cqe(struct ioring_data *ld,
+						  unsigned index)
+{
+	return &ld->cq_ring.cqes[index << ld->entry_shift];
+}
+
+static int io_uring_enter(struct thread_data *td, unsigned int to_submit,
+			  unsigned int min_complete, unsigned int flags,
+			  struct io_uring_getevents_arg *arg)
+{
+	struct ioring_data *ld = td->io_ops_data;
+
+	td->ts.nr_syscalls++;
+
+	if (arg)
+		return syscall(__NR_io_uring_enter, ld->ring_fd, to_submit,
+				min_complete, flags | IORING_ENTER_EXT_ARG,
+				arg, sizeof(*arg));
+
 	return syscall(__NR_io_uring_enter, ld->ring_fd, to_submit,
 			min_complete, flags, NULL, 0);
 }
 
+/*
+ * Hand buffer 'bid' back to the kernel managed provided buffer ring. The
+ * kernel only looks at the ring tail, so publish it right away.
+ */
+static void fio_ioring_buf_ring_add(struct thread_data *td,
+				    struct ioring_data *ld, int bid)
+{
+	struct io_uring_buf *buf;
+
+	buf = &ld->buf_ring->bufs[ld->buf_ring_tail & ld->buf_ring_mask];
+	buf->addr = (unsigned long) ld->bufs[bid];
+	buf->len = td_max_bs(td);
+	buf->bid = bid;
+	ld->buf_ring_tail++;
+
+	write_barrier();
+	ld->buf_ring->tail = ld->buf_ring_tail;
+}
+
 static int fio_ioring_prep(struct thread_data *td, struct io_u *io_u)
 {
 	struct ioring_data *ld = td->io_ops_data;
@@ -208,14 +347,29 @@ static int fio_ioring_prep(struct thread_data *td, struct io_u *io_u)
 	memset(sqe, 0, sizeof(*sqe));
 
 	if (o->registerfiles) {
-		sqe->fd = f->engine_pos;
+		sqe->fd = f->fileno;
 		sqe->flags = IOSQE_FIXED_FILE;
 	} else {
 		sqe->fd = f->fd;
 	}
 
 	if (io_u->ddir == DDIR_READ || io_u->ddir == DDIR_WRITE) {
-		if (o->fixedbufs) {
+		if (o->buffer_select && io_u->xfer_buf == io_u->buf) {
+			int bid = ld->io_u_bid[io_u->index];
+
+			/*
+			 * Return the buffer of our previous read, the kernel
+			 * picks whatever buffer is free when this one runs.
+			 */
+			if (bid != -1) {
+				fio_ioring_buf_ring_add(td, ld, bid);
+				ld->io_u_bid[io_u->index] = -1;
+			}
+			sqe->opcode = IORING_OP_READ;
+			sqe->flags |= IOSQE_BUFFER_SELECT;
+			sqe->buf_group = 0;
+			sqe->len = io_u->xfer_buflen;
+		} else if (o->fixedbufs) {
 			sqe->opcode = fixed_ddir_to_op[io_u->ddir];
 			sqe->addr = (unsigned long) io_u->xfer_buf;
 			sqe->len = io_u->xfer_buflen;
@@ -255,6 +409,44 @@ static int fio_ioring_prep(struct thread_data *td, struct io_u *io_u)
 	return 0;
 }
 
+#ifdef CONFIG_NVME_URING_CMD
+static int fio_ioring_cmd_prep(struct thread_data *td, struct io_u *io_u)
+{
+	struct ioring_data *ld = td->io_ops_data;
+	struct ioring_options *o = td->eo;
+	struct fio_file *f = io_u->file;
+	struct io_uring_sqe *sqe;
+
+	/* only supports nvme_uring_cmd */
+	if (o->cmd_type != FIO_URING_CMD_NVME)
+		return -EINVAL;
+
+	sqe = fio_ioring_sqe(ld, io_u->index);
+
+	/* zero out fields not used in this submission */
+	memset(sqe, 0, 2 * sizeof(*sqe));
+
+	if (o->registerfiles) {
+		sqe->fd = f->fileno;
+		sqe->flags = IOSQE_FIXED_FILE;
+	} else {
+		sqe->fd = f->fd;
+	}
+
+	if (o->fixedbufs) {
+		sqe->uring_cmd_flags = IORING_URING_CMD_FIXED;
+		sqe->buf_index = io_u->index;
+	}
+
+	sqe->opcode = IORING_OP_URING_CMD;
+	sqe->cmd_op = NVME_URING_CMD_IO;
+	sqe->user_data = (unsigned long) io_u;
+
+	return fio_nvme_uring_cmd_prep((struct nvme_uring_cmd *) sqe->cmd,
+					io_u);
+}
+#endif
+
 static struct io_u *fio_ioring_event(struct thread_data *td, int event)
 {
 	struct ioring_data *ld = td->io_ops_data;
@@ -267,6 +459,13 @@ static struct io_u *fio_ioring_event(struct thread_data *td, int event)
 	cqe = &ld->cq_ring.cqes[index];
 	io_u = (struct io_u *) (uintptr_t) cqe->user_data;
 
+	if (cqe->flags & IORING_CQE_F_BUFFER) {
+		int bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+
+		ld->io_u_bid[io_u->index] = bid;
+		io_u->buf = io_u->xfer_buf = ld->bufs[bid];
+	}
+
 	if (cqe->res != io_u->xfer_buflen) {
 		if (cqe->res > io_u->xfer_buflen)
 			io_u->error = -cqe->res;
@@ -278,6 +477,34 @@ static struct io_u *fio_ioring_event(struct thread_data *td, int event)
 	return io_u;
 }
 
+#ifdef CONFIG_NVME_URING_CMD
+static struct io_u *fio_ioring_cmd_event(struct thread_data *td, int event)
+{
+	struct ioring_data *ld = td->io_ops_data;
+	struct io_uring_cqe *cqe;
+	struct io_u *io_u;
+	unsigned index;
+
+	index = (event + ld->cq_ring_off) & ld->cq_ring_mask;
+
+	cqe = fio_ioring_cqe(ld, index);
+	io_u = (struct io_u *) (uintptr_t) cqe->user_data;
+
+	/*
+	 * The command completes as a whole, a positive result is the NVMe
+	 * status of a failed command.
+	 */
+	if (cqe->res < 0)
+		io_u->error = -cqe->res;
+	else if (cqe->res > 0)
+		io_u->error = EIO;
+	else
+		io_u->error = 0;
+
+	return io_u;
+}
+#endif
+
 static int fio_ioring_cqring_reap(struct thread_data *td, unsigned int events,
 				   unsigned int max)
 {
@@ -299,6 +526,50 @@ static int fio_ioring_cqring_reap(struct thread_data *td, unsigned int events,
 	return reaped;
 }
 
+/*
+ * Wait for as many completions as the recent arrival rate says will show
+ * up within adaptive_reap, but never for longer than that. This trades a
+ * bounded amount of completion latency for fewer io_uring_enter() calls.
+ */
+static int fio_ioring_adaptive_wait(struct thread_data *td, unsigned int left,
+				    unsigned int actual_min)
+{
+	struct ioring_data *ld = td->io_ops_data;
+	struct ioring_options *o = td->eo;
+	struct io_uring_getevents_arg arg;
+	struct ioring_timespec ts;
+	uint64_t want;
+
+	want = ld->cq_rate * o->adaptive_reap / 1000000ULL;
+	if (want < actual_min)
+		want = actual_min;
+	if (want > left)
+		want = left;
+
+	ts.tv_sec = o->adaptive_reap / 1000000;
+	ts.tv_nsec = (o->adaptive_reap % 1000000) * 1000ULL;
+
+	memset(&arg, 0, sizeof(arg));
+	arg.ts = (unsigned long) &ts;
+
+	return io_uring_enter(td, 0, want, IORING_ENTER_GETEVENTS, &arg);
+}
+
+static void fio_ioring_update_cq_rate(struct ioring_data *ld,
+				      unsigned int events)
+{
+	struct timespec now;
+	uint64_t nsec;
+
+	fio_gettime(&now, NULL);
+	nsec = ntime_since(&ld->cq_rate_time, &now);
+	if (!nsec)
+		return;
+
+	ld->cq_rate = (7 * ld->cq_rate + events * 1000000000ULL / nsec) / 8;
+	memcpy(&ld->cq_rate_time, &now, sizeof(now));
+}
+
 static int fio_ioring_getevents(struct thread_data *td, unsigned int min,
 				unsigned int max, const struct timespec *t)
 {
@@ -320,10 +591,15 @@ static int fio_ioring_getevents(struct thread_data *td, unsigned int min,
 		}
 
 		if (!o->sqpoll_thread) {
-			r = io_uring_enter(ld, 0, actual_min,
-						IORING_ENTER_GETEVENTS);
+			if (o->adaptive_reap)
+				r = fio_ioring_adaptive_wait(td, max - events,
+								actual_min);
+			else
+				r = io_uring_enter(td, 0, actual_min,
+						IORING_ENTER_GETEVENTS, NULL);
 			if (r < 0) {
-				if (errno == EAGAIN || errno == EINTR)
+				if (errno == EAGAIN || errno == EINTR ||
+				    errno == ETIME)
 					continue;
 				td_verror(td, errno, "io_uring_enter");
 				break;
@@ -331,6 +607,9 @@ static int fio_ioring_getevents(struct thread_data *td, unsigned int min,
 		}
 	} while (events < min);
 
+	if (o->adaptive_reap)
+		fio_ioring_update_cq_rate(ld, events);
+
 	return r < 0 ? r : events;
 }
 
@@ -339,12 +618,28 @@ static void fio_ioring_prio_prep(struct thread_data *td, struct io_u *io_u)
 	struct ioring_options *o = td->eo;
 	struct ioring_data *ld = td->io_ops_data;
 	if (rand_between(&td->prio_state, 0, 99) < o->cmdprio_percentage) {
-		ld->sqes[io_u->index].ioprio = IOPRIO_CLASS_RT << IOPRIO_CLASS_SHIFT;
+		fio_ioring_sqe(ld, io_u->index)->ioprio =
+					IOPRIO_CLASS_RT << IOPRIO_CLASS_SHIFT;
 		io_u->flags |= IO_U_F_PRIORITY;
 	}
 	return;
 }
 
+/*
+ * If the last SQE not yet submitted is the write this sync was scheduled
+ * for, link the two so the kernel issues the sync once the write is done,
+ * within the same io_uring_enter().
+ */
+static void fio_ioring_link_sync(struct ioring_data *ld, unsigned tail)
+{
+	struct io_sq_ring *ring = &ld->sq_ring;
+	unsigned index = ring->array[(tail - 1) & ld->sq_ring_mask];
+	struct io_u *prev = ld->io_u_index[index];
+
+	if (prev->ddir == DDIR_WRITE && (prev->flags & IO_U_F_SYNC_LINK))
+		fio_ioring_sqe(ld, index)->flags |= IOSQE_IO_LINK;
+}
+
 static enum fio_q_status fio_ioring_queue(struct thread_data *td,
 					  struct io_u *io_u)
 {
@@ -374,6 +669,19 @@ static enum fio_q_status fio_ioring_queue(struct thread_data *td,
 	if (next_tail == *ring->head)
 		return FIO_Q_BUSY;
 
+	/*
+	 * In offload mode the io_u was prepped by the parent job against its
+	 * own ring, fill in the sqe of the ring this worker submits on.
+	 */
+	if (td->parent && td->io_ops->prep(td, io_u)) {
+		io_u_mark_submit(td, 1);
+		io_u_mark_complete(td, 1);
+		return FIO_Q_COMPLETED;
+	}
+
+	if (ddir_sync(io_u->ddir) && ld->queued && !o->sqpoll_thread)
+		fio_ioring_link_sync(ld, tail);
+
 	/* ensure sqe stores are ordered with tail update */
 	write_barrier();
 	if (o->cmdprio_percentage)
@@ -427,8 +735,8 @@ static int fio_ioring_commit(struct thread_data *td)
 
 		read_barrier();
 		if (*ring->flags & IORING_SQ_NEED_WAKEUP)
-			io_uring_enter(ld, ld->queued, 0,
-					IORING_ENTER_SQ_WAKEUP);
+			io_uring_enter(td, ld->queued, 0,
+					IORING_ENTER_SQ_WAKEUP, NULL);
 		ld->queued = 0;
 		return 0;
 	}
@@ -437,7 +745,7 @@ static int fio_ioring_commit(struct thread_data *td)
 		unsigned start = *ld->sq_ring.head;
 		long nr = ld->queued;
 
-		ret = io_uring_enter(ld, nr, 0, IORING_ENTER_GETEVENTS);
+		ret = io_uring_enter(td, nr, 0, IORING_ENTER_GETEVENTS, NULL);
 		if (ret > 0) {
 			fio_ioring_queued(td, start, ret);
 			io_u_mark_submit(td, ret);
@@ -473,6 +781,77 @@ static void fio_ioring_unmap(struct ioring_data *ld)
 	close(ld->ring_fd);
 }
 
+/*
+ * Create the ring, attaching it to the SQ poll thread of its group if
+ * another ring in the group already exists. The group keeps its own
+ * reference to the first ring, so the poll thread outlives the job that
+ * happened to create it.
+ */
+static int fio_ioring_setup_shared(struct ioring_data *ld, unsigned int id,
+				   int depth, struct io_uring_params *p)
+{
+	struct ioring_sqpoll_group *grp = NULL, *tmp;
+	struct flist_head *entry;
+	int ret;
+
+	pthread_mutex_lock(&sqpoll_group_lock);
+
+	flist_for_each(entry, &sqpoll_group_list) {
+		tmp = flist_entry(entry, struct ioring_sqpoll_group, list);
+		if (tmp->id == id) {
+			grp = tmp;
+			break;
+		}
+	}
+
+	if (grp) {
+		p->flags |= IORING_SETUP_ATTACH_WQ;
+		p->wq_fd = grp->ring_fd;
+	}
+
+	ret = syscall(__NR_io_uring_setup, depth, p);
+	if (ret < 0)
+		goto out;
+
+	if (grp) {
+		grp->refcount++;
+	} else {
+		grp = malloc(sizeof(*grp));
+		INIT_FLIST_HEAD(&grp->list);
+		grp->id = id;
+		grp->ring_fd = dup(ret);
+		if (grp->ring_fd < 0) {
+			free(grp);
+			close(ret);
+			ret = -1;
+			goto out;
+		}
+		grp->refcount = 1;
+		flist_add_tail(&grp->list, &sqpoll_group_list);
+	}
+
+	ld->sqpoll_group = grp;
+out:
+	pthread_mutex_unlock(&sqpoll_group_lock);
+	return ret;
+}
+
+static void fio_ioring_put_shared(struct ioring_data *ld)
+{
+	struct ioring_sqpoll_group *grp = ld->sqpoll_group;
+
+	pthread_mutex_lock(&sqpoll_group_lock);
+
+	if (!--grp->refcount) {
+		flist_del(&grp->list);
+		close(grp->ring_fd);
+		free(grp);
+	}
+
+	pthread_mutex_unlock(&sqpoll_group_lock);
+	ld->sqpoll_group = NULL;
+}
+
 static void fio_ioring_cleanup(struct thread_data *td)
 {
 	struct ioring_data *ld = td->io_ops_data;
@@ -480,9 +859,14 @@ static void fio_ioring_cleanup(struct thread_data *td)
 	if (ld) {
 		if (!(td->flags & TD_F_CHILD))
 			fio_ioring_unmap(ld);
+		if (ld->sqpoll_group)
+			fio_ioring_put_shared(ld);
 
 		free(ld->io_u_index);
 		free(ld->iovecs);
+		free(ld->buf_ring);
+		free(ld->bufs);
+		free(ld->io_u_bid);
 		free(ld->fds);
 		free(ld);
 	}
@@ -507,14 +891,15 @@ static int fio_ioring_mmap(struct ioring_data *ld, struct io_uring_params *p)
 	sring->array = ptr + p->sq_off.array;
 	ld->sq_ring_mask = *sring->ring_mask;
 
-	ld->mmap[1].len = p->sq_entries * sizeof(struct io_uring_sqe);
+	ld->mmap[1].len = (p->sq_entries << ld->entry_shift) *
+				sizeof(struct io_uring_sqe);
 	ld->sqes = mmap(0, ld->mmap[1].len, PROT_READ | PROT_WRITE,
 				MAP_SHARED | MAP_POPULATE, ld->ring_fd,
 				IORING_OFF_SQES);
 	ld->mmap[1].ptr = ld->sqes;
 
-	ld->mmap[2].len = p->cq_off.cqes +
-				p->cq_entries * sizeof(struct io_uring_cqe);
+	ld->mmap[2].len = p->cq_off.cqes + (p->cq_entries << ld->entry_shift) *
+				sizeof(struct io_uring_cqe);
 	ptr = mmap(0, ld->mmap[2].len, PROT_READ | PROT_WRITE,
 			MAP_SHARED | MAP_POPULATE, ld->ring_fd,
 			IORING_OFF_CQ_RING);
@@ -532,7 +917,7 @@ static int fio_ioring_queue_init(struct thread_data *td)
 {
 	struct ioring_data *ld = td->io_ops_data;
 	struct ioring_options *o = td->eo;
-	int depth = td->o.iodepth;
+	int depth = ld->ring_depth;
 	struct io_uring_params p;
 	int ret;
 
@@ -540,6 +925,8 @@ static int fio_ioring_queue_init(struct thread_data *td)
 
 	if (o->hipri)
 		p.flags |= IORING_SETUP_IOPOLL;
+	if (ld->entry_shift)
+		p.flags |= IORING_SETUP_SQE128 | IORING_SETUP_CQE32;
 	if (o->sqpoll_thread) {
 		p.flags |= IORING_SETUP_SQPOLL;
 		if (o->sqpoll_set) {
@@ -548,12 +935,22 @@ static int fio_ioring_queue_init(struct thread_data *td)
 		}
 	}
 
-	ret = syscall(__NR_io_uring_setup, depth, &p);
+	if (o->sqpoll_thread && o->sqpoll_shared)
+		ret = fio_ioring_setup_shared(ld, o->sqpoll_shared, depth, &p);
+	else
+		ret = syscall(__NR_io_uring_setup, depth, &p);
 	if (ret < 0)
 		return ret;
 
 	ld->ring_fd = ret;
 
+	if (o->adaptive_reap && !(p.features & IORING_FEAT_EXT_ARG)) {
+		log_info("fio: io_uring: kernel lacks EXT_ARG support, "
+			 "disabling adaptive_reap\n");
+		o->adaptive_reap = 0;
+	}
+	fio_gettime(&ld->cq_rate_time, NULL);
+
 	if (o->fixedbufs) {
 		struct rlimit rlim = {
 			.rlim_cur = RLIM_INFINITY,
@@ -581,12 +978,23 @@ static int fio_ioring_register_files(struct thread_data *td)
 
 	ld->fds = calloc(td->o.nr_files, sizeof(int));
 
+	/*
+	 * Offload workers submit against the parent job's files, register
+	 * the descriptors its ring holds rather than opening them again.
+	 */
+	if (td->parent) {
+		struct ioring_data *pld = td->parent->io_ops_data;
+
+		memcpy(ld->fds, pld->fds, td->o.nr_files * sizeof(int));
+		return syscall(__NR_io_uring_register, ld->ring_fd,
+				IORING_REGISTER_FILES, ld->fds, td->o.nr_files);
+	}
+
 	for_each_file(td, f, i) {
 		ret = generic_open_file(td, f);
 		if (ret)
 			goto err;
 		ld->fds[i] = f->fd;
-		f->engine_pos = i;
 	}
 
 	ret = syscall(__NR_io_uring_register, ld->ring_fd,
@@ -612,6 +1020,47 @@ err:
 	return ret;
 }
 
+static int fio_ioring_register_buf_ring(struct thread_data *td)
+{
+	struct ioring_data *ld = td->io_ops_data;
+	struct io_uring_buf_reg reg;
+	size_t size;
+	int i, ret;
+
+	size = ld->ring_depth * sizeof(struct io_uring_buf);
+	ret = posix_memalign((void **) &ld->buf_ring, page_size, size);
+	if (ret) {
+		ld->buf_ring = NULL;
+		errno = ret;
+		return -1;
+	}
+	memset(ld->buf_ring, 0, size);
+
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (unsigned long) ld->buf_ring;
+	reg.ring_entries = ld->ring_depth;
+	reg.bgid = 0;
+
+	ret = syscall(__NR_io_uring_register, ld->ring_fd,
+			IORING_REGISTER_PBUF_RING, &reg, 1);
+	if (ret < 0)
+		return ret;
+
+	/*
+	 * The io_u buffers make up the pool. io_us start out without a
+	 * buffer and hold on to the one the kernel picked for them until
+	 * they are prepared for the next read.
+	 */
+	ld->buf_ring_mask = ld->ring_depth - 1;
+	for (i = 0; i < ld->ring_depth; i++) {
+		ld->bufs[i] = ld->io_u_index[i]->buf;
+		ld->io_u_bid[i] = -1;
+		fio_ioring_buf_ring_add(td, ld, i);
+	}
+
+	return 0;
+}
+
 static int fio_ioring_post_init(struct thread_data *td)
 {
 	struct ioring_data *ld = td->io_ops_data;
@@ -619,7 +1068,16 @@ static int fio_ioring_post_init(struct thread_data *td)
 	struct io_u *io_u;
 	int err, i;
 
-	for (i = 0; i < td->o.iodepth; i++) {
+	/*
+	 * Offload workers never see io_u_init(), they queue io_us from the
+	 * parent job's pool.
+	 */
+	if (td->parent) {
+		for (i = 0; i < ld->ring_depth; i++)
+			ld->io_u_index[i] = td->parent->io_u_all.io_us[i];
+	}
+
+	for (i = 0; i < ld->ring_depth; i++) {
 		struct iovec *iov = &ld->iovecs[i];
 
 		io_u = ld->io_u_index[i];
@@ -641,6 +1099,14 @@ static int fio_ioring_post_init(struct thread_data *td)
 		}
 	}
 
+	if (o->buffer_select) {
+		err = fio_ioring_register_buf_ring(td);
+		if (err) {
+			td_verror(td, errno, "ioring_register_buf_ring");
+			return 1;
+		}
+	}
+
 	return 0;
 }
 
@@ -665,15 +1131,54 @@ static int fio_ioring_init(struct thread_data *td)
 		return 1;
 	}
 
+	/*
+	 * The group owner's ring fd is what other rings attach to, and file
+	 * descriptors are only shared between jobs that run as threads.
+	 */
+	if (o->sqpoll_shared && !td->o.use_thread) {
+		log_err("fio: io_uring sqthread_poll_shared requires thread=1\n");
+		return 1;
+	}
+
+	/*
+	 * Selected buffers are only ever filled by the kernel, writes need
+	 * to own their buffer for the lifetime of the io_u.
+	 */
+	if (o->buffer_select && (td_write(td) || o->fixedbufs)) {
+		log_err("fio: io_uring buffer_select requires a read-only "
+			"workload without fixedbufs\n");
+		return 1;
+	}
+
+	/*
+	 * Offload workers would each add the shared io_u buffers to their
+	 * own buffer ring.
+	 */
+	if (o->buffer_select && td->o.io_submit_mode == IO_MODE_OFFLOAD) {
+		log_err("fio: io_uring buffer_select does not work with "
+			"io_submit_mode=offload\n");
+		return 1;
+	}
+
 	ld = calloc(1, sizeof(*ld));
 
-	/* ring depth must be a power-of-2 */
 	ld->iodepth = td->o.iodepth;
-	td->o.iodepth = roundup_pow2(td->o.iodepth);
+	if (td->parent) {
+		/* sqes are indexed by the io_u's index in the parent's pool */
+		ld->ring_depth = td->parent->io_u_all.nr;
+	} else {
+		/* ring depth must be a power-of-2 */
+		td->o.iodepth = roundup_pow2(td->o.iodepth);
+		ld->ring_depth = td->o.iodepth;
+	}
 
 	/* io_u index */
-	ld->io_u_index = calloc(td->o.iodepth, sizeof(struct io_u *));
-	ld->iovecs = calloc(td->o.iodepth, sizeof(struct iovec));
+	ld->io_u_index = calloc(ld->ring_depth, sizeof(struct io_u *));
+	ld->iovecs = calloc(ld->ring_depth, sizeof(struct iovec));
+	if (o->buffer_select) {
+		ld->bufs = calloc(ld->ring_depth, sizeof(char *));
+		ld->io_u_bid = calloc(ld->ring_depth, sizeof(int));
+	}
 
 	td->io_ops_data = ld;
 
@@ -706,7 +1211,7 @@ static int fio_ioring_open_file(struct thread_data *td, struct fio_file *f)
 	if (!ld || !o->registerfiles)
 		return generic_open_file(td, f);
 
-	f->fd = ld->fds[f->engine_pos];
+	f->fd = ld->fds[f->fileno];
 	return 0;
 }
 
@@ -722,6 +1227,96 @@ static int fio_ioring_close_file(struct thread_data *td, struct fio_file *f)
 	return 0;
 }
 
+#ifdef CONFIG_NVME_URING_CMD
+static int fio_ioring_cmd_init(struct thread_data *td)
+{
+	struct ioring_options *o = td->eo;
+	struct ioring_data *ld;
+	int ret;
+
+	if (o->buffer_select) {
+		log_err("fio: io_uring_cmd does not support buffer_select\n");
+		return 1;
+	}
+
+	ret = fio_ioring_init(td);
+	if (ret)
+		return ret;
+
+	ld = td->io_ops_data;
+	ld->entry_shift = 1;
+	return 0;
+}
+
+static int fio_ioring_cmd_get_nvme_data(struct fio_file *f)
+{
+	struct nvme_data *data;
+	__u32 nsid, lba_sz;
+	__u64 nlba;
+	int ret;
+
+	if (FILE_ENG_DATA(f))
+		return 0;
+
+	ret = fio_nvme_get_info(f, &nsid, &lba_sz, &nlba);
+	if (ret)
+		return ret;
+
+	data = calloc(1, sizeof(struct nvme_data));
+	data->nsid = nsid;
+	data->lba_shift = __fls(lba_sz) - 1;
+	FILE_SET_ENG_DATA(f, data);
+
+	f->real_file_size = lba_sz * nlba;
+	fio_file_set_size_known(f);
+	return 0;
+}
+
+static int fio_ioring_cmd_open_file(struct thread_data *td, struct fio_file *f)
+{
+	struct ioring_data *ld = td->io_ops_data;
+	struct ioring_options *o = td->eo;
+	int ret;
+
+	ret = fio_ioring_cmd_get_nvme_data(f);
+	if (ret)
+		return ret;
+
+	if (!ld || !o->registerfiles)
+		return generic_open_file(td, f);
+
+	f->fd = ld->fds[f->fileno];
+	return 0;
+}
+
+static int fio_ioring_cmd_get_file_size(struct thread_data *td,
+					struct fio_file *f)
+{
+	int ret;
+
+	ret = fio_ioring_cmd_get_nvme_data(f);
+	if (ret) {
+		td_verror(td, -ret, "fio_nvme_get_info");
+		f->real_file_size = -1ULL;
+	}
+
+	return ret;
+}
+
+static void fio_ioring_cmd_cleanup(struct thread_data *td)
+{
+	struct fio_file *f;
+	unsigned int i;
+
+	for_each_file(td, f, i) {
+		free(FILE_ENG_DATA(f));
+		FILE_SET_ENG_DATA(f, NULL);
+	}
+
+	fio_ioring_cleanup(td);
+}
+#endif
+
 static struct ioengine_ops ioengine = {
 	.name			= "io_uring",
 	.version		= FIO_IOOPS_VERSION,
@@ -742,13 +1337,41 @@ static struct ioengine_ops ioengine = {
 	.option_struct_size	= sizeof(struct ioring_options),
 };
 
+#ifdef CONFIG_NVME_URING_CMD
+static struct ioengine_ops ioengine_uring_cmd = {
+	.name			= "io_uring_cmd",
+	.version		= FIO_IOOPS_VERSION,
+	.flags			= FIO_ASYNCIO_SYNC_TRIM,
+	.init			= fio_ioring_cmd_init,
+	.post_init		= fio_ioring_post_init,
+	.io_u_init		= fio_ioring_io_u_init,
+	.prep			= fio_ioring_cmd_prep,
+	.queue			= fio_ioring_queue,
+	.commit			= fio_ioring_commit,
+	.getevents		= fio_ioring_getevents,
+	.event			= fio_ioring_cmd_event,
+	.cleanup		= fio_ioring_cmd_cleanup,
+	.open_file		= fio_ioring_cmd_open_file,
+	.close_file		= fio_ioring_close_file,
+	.get_file_size		= fio_ioring_cmd_get_file_size,
+	.options		= options,
+	.option_struct_size	= sizeof(struct ioring_options),
+};
+#endif
+
 static void fio_init fio_ioring_register(void)
 {
 	register_ioengine(&ioengine);
+#ifdef CONFIG_NVME_URING_CMD
+	register_ioengine(&ioengine_uring_cmd);
+#endif
 }
 
 static void fio_exit fio_ioring_unregister(void)
 {
 	unregister_ioengine(&ioengine);
+#ifdef CONFIG_NVME_URING_CMD
+	unregister_ioengine(&ioengine_uring_cmd);
+#endif
 }
 #endif
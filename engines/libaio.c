@@ -21,7 +21,7 @@
 #define IOCB_FLAG_IOPRIO    (1 << 1)
 #endif
 
-static int fio_libaio_commit(struct thread_data *td);
+static int fio_libaio_submit(struct thread_data *td);
 static int fio_libaio_init(struct thread_data *td);
 
 struct libaio_data {
@@ -45,12 +45,23 @@ struct libaio_data {
 	unsigned int queued;
 	unsigned int head;
 	unsigned int tail;
+
+	/*
+	 * Submit coalescing. 'queued_bytes' is the size of the iocbs not
+	 * yet handed to io_submit(), 'submit_gap' a running average of
+	 * the time between io_submit() calls, in usec.
+	 */
+	unsigned long long queued_bytes;
+	struct timespec last_submit;
+	uint64_t submit_gap;
 };
 
 struct libaio_options {
 	void *pad;
 	unsigned int userspace_reap;
 	unsigned int cmdprio_percentage;
+	unsigned int coalesce_nr;
+	unsigned long long coalesce_bytes;
 };
 
 static struct fio_option options[] = {
@@ -63,6 +74,26 @@ static struct fio_option options[] = {
 		.category = FIO_OPT_C_ENGINE,
 		.group	= FIO_OPT_G_LIBAIO,
 	},
+	{
+		.name	= "coalesce_nr",
+		.lname	= "Libaio submit coalescing count",
+		.type	= FIO_OPT_INT,
+		.off1	= offsetof(struct libaio_options, coalesce_nr),
+		.help	= "Gather up to this many iocbs before calling io_submit",
+		.def	= "0",
+		.category = FIO_OPT_C_ENGINE,
+		.group	= FIO_OPT_G_LIBAIO,
+	},
+	{
+		.name	= "coalesce_bytes",
+		.lname	= "Libaio submit coalescing size",
+		.type	= FIO_OPT_STR_VAL,
+		.off1	= offsetof(struct libaio_options, coalesce_bytes),
+		.help	= "Gather up to this many bytes before calling io_submit",
+		.def	= "0",
+		.category = FIO_OPT_C_ENGINE,
+		.group	= FIO_OPT_G_LIBAIO,
+	},
 #ifdef FIO_HAVE_IOPRIO_CLASS
 	{
 		.name	= "cmdprio_percentage",
@@ -198,6 +229,13 @@ static int fio_libaio_getevents(struct thread_data *td, unsigned int min,
 		lt = &__lt;
 	}
 
+	/*
+	 * Don't wait for completions with iocbs still held back for
+	 * coalescing, they may be what we're waiting for.
+	 */
+	if (ld->queued && min)
+		fio_libaio_submit(td);
+
 	do {
 		if (o->userspace_reap == 1
 		    && actual_min == 0
@@ -208,11 +246,12 @@ static int fio_libaio_getevents(struct thread_data *td, unsigned int min,
 		} else {
 			r = io_getevents(ld->aio_ctx, actual_min,
 				max, ld->aio_events + events, lt);
+			td->ts.nr_syscalls++;
 		}
 		if (r > 0)
 			events += r;
 		else if ((min && r == 0) || r == -EAGAIN) {
-			fio_libaio_commit(td);
+			fio_libaio_submit(td);
 			if (actual_min)
 				usleep(10);
 		} else if (r != -EINTR)
@@ -264,6 +303,7 @@ static enum fio_q_status fio_libaio_queue(struct thread_data *td,
 	ld->io_us[ld->head] = io_u;
 	ring_inc(ld, &ld->head, 1);
 	ld->queued++;
+	ld->queued_bytes += io_u->xfer_buflen;
 	return FIO_Q_QUEUED;
 }
 
@@ -286,7 +326,54 @@ static void fio_libaio_queued(struct thread_data *td, struct io_u **io_us,
 	}
 }
 
+static void fio_libaio_submitted(struct libaio_data *ld, struct io_u **io_us,
+				 unsigned int nr)
+{
+	struct timespec now;
+	unsigned int i;
+
+	for (i = 0; i < nr; i++)
+		ld->queued_bytes -= io_us[i]->xfer_buflen;
+
+	fio_gettime(&now, NULL);
+	ld->submit_gap = (7 * ld->submit_gap +
+				utime_since(&ld->last_submit, &now)) / 8;
+	ld->last_submit = now;
+}
+
+/*
+ * With coalescing enabled, hold the iocbs gathered so far back from
+ * io_submit() while the device still has IO in flight, until a budget
+ * is reached or until it has been as long since the last io_submit()
+ * as the gap between earlier ones. The time window thus follows the
+ * rate at which the job queues IO.
+ */
+static bool fio_libaio_coalesce(struct thread_data *td)
+{
+	struct libaio_data *ld = td->io_ops_data;
+	struct libaio_options *o = td->eo;
+
+	if (!o->coalesce_nr && !o->coalesce_bytes)
+		return false;
+	if (ld->queued == ld->entries || td->cur_depth <= ld->queued)
+		return false;
+	if (o->coalesce_nr && ld->queued >= o->coalesce_nr)
+		return false;
+	if (o->coalesce_bytes && ld->queued_bytes >= o->coalesce_bytes)
+		return false;
+
+	return utime_since_now(&ld->last_submit) < ld->submit_gap;
+}
+
 static int fio_libaio_commit(struct thread_data *td)
+{
+	if (fio_libaio_coalesce(td))
+		return 0;
+
+	return fio_libaio_submit(td);
+}
+
+static int fio_libaio_submit(struct thread_data *td)
 {
 	struct libaio_data *ld = td->io_ops_data;
 	struct iocb **iocbs;
@@ -305,8 +392,10 @@ static int fio_libaio_commit(struct thread_data *td)
 		iocbs = ld->iocbs + ld->tail;
 
 		ret = io_submit(ld->aio_ctx, nr, iocbs);
+		td->ts.nr_syscalls++;
 		if (ret > 0) {
 			fio_libaio_queued(td, io_us, ret);
+			fio_libaio_submitted(ld, io_us, ret);
 			io_u_mark_submit(td, ret);
 
 			ld->queued -= ret;
@@ -394,6 +483,7 @@ static int fio_libaio_post_init(struct thread_data *td)
 		return 1;
 	}
 
+	fio_gettime(&ld->last_submit, NULL);
 	return 0;
 }
 
@@ -17,6 +17,9 @@
 #include <sys/stat.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#ifdef CONFIG_NET_ZEROCOPY
+#include <linux/errqueue.h>
+#endif
 
 #include "../fio.h"
 #include "../verify.h"
@@ -32,6 +35,28 @@ struct netio_data {
 	struct sockaddr_un addr_un;
 	uint64_t udp_send_seq;
 	uint64_t udp_recv_seq;
+
+	/*
+	 * MSG_ZEROCOPY sends. The kernel numbers each zerocopy send() on
+	 * the socket, an io_u is done once all of its sends are notified
+	 * on the error queue and its buffer is released.
+	 */
+	struct netio_zc *zc;
+	struct io_u **zc_events;
+	unsigned int zc_nr_events;
+	unsigned int zc_nr_returned;
+	unsigned int zc_pending;
+	uint32_t zc_seq;
+};
+
+struct netio_zc {
+	struct io_u *io_u;
+	uint32_t first;
+	uint32_t nr;
+	uint32_t left;
+	bool sending;
+	bool copied;
+	unsigned long long bytes;
 };
 
 struct netio_options {
@@ -44,6 +69,7 @@ struct netio_options {
 	unsigned int ttl;
 	unsigned int window_size;
 	unsigned int mss;
+	unsigned int zerocopy;
 	char *intfc;
 };
 
@@ -202,6 +228,17 @@ static struct fio_option options[] = {
 		.category = FIO_OPT_C_ENGINE,
 		.group	= FIO_OPT_G_NETIO,
 	},
+#endif
+#ifdef CONFIG_NET_ZEROCOPY
+	{
+		.name	= "zerocopy",
+		.lname	= "Zero copy send",
+		.type	= FIO_OPT_BOOL,
+		.off1	= offsetof(struct netio_options, zerocopy),
+		.help	= "Send with MSG_ZEROCOPY on TCP connections",
+		.category = FIO_OPT_C_ENGINE,
+		.group	= FIO_OPT_G_NETIO,
+	},
 #endif
 	{
 		.name	= NULL,
@@ -281,6 +318,25 @@ static int set_mss(struct thread_data *td, int fd)
 #endif
 }
 
+static int set_zerocopy(struct thread_data *td, int fd)
+{
+#ifdef CONFIG_NET_ZEROCOPY
+	int one = 1, ret;
+
+	if (!td_write(td))
+		return 0;
+
+	ret = setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, (void *) &one,
+				sizeof(one));
+	if (ret < 0)
+		td_verror(td, errno, "setsockopt SO_ZEROCOPY");
+
+	return ret;
+#else
+	td_verror(td, -EINVAL, "setsockopt SO_ZEROCOPY");
+	return -1;
+#endif
+}
 
 /*
  * Return -1 for error and 'nr events' for a positive number
@@ -569,6 +625,218 @@ static int fio_netio_send(struct thread_data *td, struct io_u *io_u)
 	return ret;
 }
 
+#ifdef CONFIG_NET_ZEROCOPY
+static void fio_netio_zc_done(struct thread_data *td, struct netio_zc *zc)
+{
+	struct netio_data *nd = td->io_ops_data;
+
+	if (!zc->copied)
+		td->ts.zerocopy_bytes += zc->bytes;
+
+	nd->zc_events[nd->zc_nr_events++] = zc->io_u;
+	nd->zc_pending--;
+	zc->io_u = NULL;
+}
+
+/*
+ * Sends [lo, hi] were released. If the kernel had to copy any of them
+ * after all, don't count that io_u as sent without a copy.
+ */
+static void fio_netio_zc_complete(struct thread_data *td, uint32_t lo,
+				  uint32_t hi, bool copied)
+{
+	struct netio_data *nd = td->io_ops_data;
+	int i;
+
+	for (i = 0; i < td->o.iodepth; i++) {
+		struct netio_zc *zc = &nd->zc[i];
+		uint32_t start, end;
+
+		if (!zc->io_u || !zc->nr)
+			continue;
+
+		start = max(lo, zc->first);
+		end = min(hi, zc->first + zc->nr - 1);
+		if (start > end)
+			continue;
+
+		zc->left -= end - start + 1;
+		if (copied)
+			zc->copied = true;
+		if (!zc->left && !zc->sending)
+			fio_netio_zc_done(td, zc);
+	}
+}
+
+/*
+ * Drain the notifications on the socket error queue, never blocks
+ */
+static int fio_netio_zc_reap(struct thread_data *td, int fd)
+{
+	char control[CMSG_SPACE(sizeof(struct sock_extended_err) +
+				sizeof(struct sockaddr_in6))];
+	struct sock_extended_err *serr;
+	struct cmsghdr *cm;
+	struct msghdr msg;
+	int ret;
+
+	do {
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		ret = recvmsg(fd, &msg, MSG_ERRQUEUE);
+		if (ret < 0) {
+			if (errno == EAGAIN || errno == EINTR)
+				return 0;
+			td_verror(td, errno, "recvmsg zerocopy");
+			return -1;
+		}
+
+		for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+			if (!(cm->cmsg_level == SOL_IP &&
+			      cm->cmsg_type == IP_RECVERR) &&
+			    !(cm->cmsg_level == SOL_IPV6 &&
+			      cm->cmsg_type == IPV6_RECVERR))
+				continue;
+
+			serr = (struct sock_extended_err *) CMSG_DATA(cm);
+			if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+				continue;
+			if (serr->ee_errno) {
+				td_verror(td, serr->ee_errno, "zerocopy");
+				return -1;
+			}
+
+			fio_netio_zc_complete(td, serr->ee_info, serr->ee_data,
+				serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED);
+		}
+	} while (1);
+}
+
+/*
+ * Send the whole io_u with MSG_ZEROCOPY. The io_u stays queued until
+ * the kernel has released its buffer.
+ */
+static enum fio_q_status fio_netio_queue_zc(struct thread_data *td,
+					    struct io_u *io_u)
+{
+	struct netio_data *nd = td->io_ops_data;
+	struct netio_options *o = td->eo;
+	int fd = io_u->file->fd;
+	struct netio_zc *zc = NULL;
+	int i, ret, flags = MSG_ZEROCOPY;
+
+	for (i = 0; i < td->o.iodepth; i++) {
+		if (!nd->zc[i].io_u) {
+			zc = &nd->zc[i];
+			break;
+		}
+	}
+	if (!zc)
+		return FIO_Q_BUSY;
+
+	memset(zc, 0, sizeof(*zc));
+	zc->io_u = io_u;
+	zc->first = nd->zc_seq;
+	zc->sending = true;
+	nd->zc_pending++;
+
+#ifdef MSG_MORE
+	if ((td->this_io_bytes[DDIR_WRITE] + io_u->xfer_buflen <
+	    td->o.size) && !o->pingpong)
+		flags |= MSG_MORE;
+#endif
+
+	while (zc->bytes < io_u->xfer_buflen) {
+		ret = send(fd, io_u->xfer_buf + zc->bytes,
+				io_u->xfer_buflen - zc->bytes, flags);
+		if (ret > 0) {
+			zc->bytes += ret;
+			zc->nr++;
+			zc->left++;
+			nd->zc_seq++;
+			continue;
+		}
+
+		/*
+		 * ENOBUFS means too many sends are still waiting to be
+		 * released, wait for notifications rather than for space
+		 * in the socket.
+		 */
+		if (ret < 0 && errno == ENOBUFS) {
+			if (fio_netio_zc_reap(td, fd) < 0)
+				break;
+			if (poll_wait(td, fd, POLLERR) < 0)
+				ret = -1;
+		} else if (ret < 0 && errno != EAGAIN && errno != EINTR)
+			break;
+		else
+			ret = poll_wait(td, fd, POLLOUT);
+
+		if (ret < 0) {
+			io_u->error = errno ?: EIO;
+			break;
+		}
+	}
+
+	if (zc->bytes < io_u->xfer_buflen && !io_u->error)
+		io_u->error = errno ?: EIO;
+	if (io_u->error) {
+		td_verror(td, io_u->error, "xfer");
+		io_u->resid = io_u->xfer_buflen - zc->bytes;
+	}
+
+	zc->sending = false;
+	if (!zc->nr) {
+		zc->io_u = NULL;
+		nd->zc_pending--;
+		return FIO_Q_COMPLETED;
+	}
+	if (!zc->left)
+		fio_netio_zc_done(td, zc);
+
+	return FIO_Q_QUEUED;
+}
+
+static int fio_netio_getevents(struct thread_data *td, unsigned int min,
+			       unsigned int max,
+			       const struct timespec fio_unused *t)
+{
+	struct netio_data *nd = td->io_ops_data;
+	struct fio_file *f = td->files[0];
+	unsigned int nr;
+
+	/* drop the events handed out by the previous call */
+	if (nd->zc_nr_returned) {
+		nd->zc_nr_events -= nd->zc_nr_returned;
+		memmove(nd->zc_events, nd->zc_events + nd->zc_nr_returned,
+			nd->zc_nr_events * sizeof(struct io_u *));
+		nd->zc_nr_returned = 0;
+	}
+
+	while (nd->zc_pending) {
+		if (fio_netio_zc_reap(td, f->fd) < 0)
+			return -1;
+		if (nd->zc_nr_events >= min)
+			break;
+		if (poll_wait(td, f->fd, POLLERR) < 0 && td->terminate)
+			break;
+	}
+
+	nr = min(nd->zc_nr_events, max);
+	nd->zc_nr_returned = nr;
+	return nr;
+}
+
+static struct io_u *fio_netio_event(struct thread_data *td, int event)
+{
+	struct netio_data *nd = td->io_ops_data;
+
+	return nd->zc_events[event];
+}
+#endif
+
 static int is_close_msg(struct io_u *io_u, int len)
 {
 	struct udp_close_msg *msg;
@@ -696,6 +964,11 @@ static enum fio_q_status fio_netio_queue(struct thread_data *td,
 
 	fio_ro_check(td, io_u);
 
+#ifdef CONFIG_NET_ZEROCOPY
+	if (o->zerocopy && io_u->ddir == DDIR_WRITE)
+		return fio_netio_queue_zc(td, io_u);
+#endif
+
 	ret = __fio_netio_queue(td, io_u, io_u->ddir);
 	if (!o->pingpong || ret != FIO_Q_COMPLETED)
 		return ret;
@@ -905,11 +1178,17 @@ static void fio_netio_send_close(struct thread_data *td, struct fio_file *f)
 
 static int fio_netio_close_file(struct thread_data *td, struct fio_file *f)
 {
+	struct netio_data *nd = td->io_ops_data;
+
 	/*
 	 * Notify the receiver that we are closing down the link
 	 */
 	fio_netio_send_close(td, f);
 
+	/* zerocopy sends are numbered from 0 on every new socket */
+	if (nd)
+		nd->zc_seq = 0;
+
 	return generic_close_file(td, f);
 }
 
@@ -1004,6 +1283,9 @@ static int fio_netio_open_file(struct thread_data *td, struct fio_file *f)
 		}
 	}
 
+	if (!ret && o->zerocopy)
+		ret = set_zerocopy(td, f->fd);
+
 	if (ret)
 		fio_netio_close_file(td, f);
 
@@ -1334,6 +1616,22 @@ static int fio_netio_init(struct thread_data *td)
 		o->listen = td_read(td);
 	}
 
+	if (o->zerocopy) {
+		struct netio_data *nd = td->io_ops_data;
+
+		if (!is_tcp(o) || nd->use_splice || o->pingpong) {
+			log_err("fio: zerocopy is only valid for TCP send/recv"
+				" without pingpong\n");
+			return 1;
+		}
+		if (td->o.nr_files > 1) {
+			log_err("fio: zerocopy needs a single connection\n");
+			return 1;
+		}
+		nd->zc = calloc(td->o.iodepth, sizeof(struct netio_zc));
+		nd->zc_events = calloc(td->o.iodepth, sizeof(struct io_u *));
+	}
+
 	if (o->listen)
 		ret = fio_netio_setup_listen(td);
 	else
@@ -1354,6 +1652,8 @@ static void fio_netio_cleanup(struct thread_data *td)
 		if (nd->pipes[1] != -1)
 			close(nd->pipes[1]);
 
+		free(nd->zc);
+		free(nd->zc_events);
 		free(nd);
 	}
 }
@@ -1433,6 +1733,10 @@ static struct ioengine_ops ioengine_rw = {
 	.open_file		= fio_netio_open_file,
 	.close_file		= fio_netio_close_file,
 	.terminate		= fio_netio_terminate,
+#ifdef CONFIG_NET_ZEROCOPY
+	.getevents		= fio_netio_getevents,
+	.event			= fio_netio_event,
+#endif
 	.options		= options,
 	.option_struct_size	= sizeof(struct netio_options),
 	.flags			= FIO_SYNCIO | FIO_DISKLESSIO | FIO_UNIDIR |
@@ -32,6 +32,19 @@ struct syncio_data {
 	enum fio_ddir last_ddir;
 
 	struct frand_state rand_state;
+
+	/*
+	 * pvsync2 nowait_workers: reads that would block are done by a
+	 * pool of workers and handed back on 'done' for ->getevents().
+	 * 'punted' counts those not reaped yet.
+	 */
+	struct workqueue wq;
+	pthread_mutex_t done_lock;
+	pthread_cond_t done_cond;
+	struct io_u **done;
+	unsigned int nr_done;
+	unsigned int punted;
+	int *rw_flags;
 };
 
 #ifdef FIO_HAVE_PWRITEV2
@@ -40,6 +53,7 @@ struct psyncv2_options {
 	unsigned int hipri;
 	unsigned int hipri_percentage;
 	unsigned int uncached;
+	unsigned int nowait_workers;
 };
 
 static struct fio_option options[] = {
@@ -73,6 +87,16 @@ static struct fio_option options[] = {
 		.category = FIO_OPT_C_ENGINE,
 		.group	= FIO_OPT_G_INVALID,
 	},
+	{
+		.name	= "nowait_workers",
+		.lname	= "RWF_NOWAIT workers",
+		.type	= FIO_OPT_INT,
+		.off1	= offsetof(struct psyncv2_options, nowait_workers),
+		.def	= "0",
+		.help	= "Try reads with RWF_NOWAIT, hand off those that would block to this many threads",
+		.category = FIO_OPT_C_ENGINE,
+		.group	= FIO_OPT_G_INVALID,
+	},
 	{
 		.name	= NULL,
 	},
@@ -168,7 +192,15 @@ static enum fio_q_status fio_pvsyncio2_queue(struct thread_data *td,
 	iov->iov_base = io_u->xfer_buf;
 	iov->iov_len = io_u->xfer_buflen;
 
-	if (io_u->ddir == DDIR_READ)
+	if (io_u->ddir == DDIR_READ && o->nowait_workers) {
+		ret = preadv2(f->fd, iov, 1, io_u->offset, flags | RWF_NOWAIT);
+		if (ret == -1 && errno == EAGAIN) {
+			sd->rw_flags[io_u->index] = flags;
+			sd->punted++;
+			workqueue_enqueue(&sd->wq, &io_u->work);
+			return FIO_Q_QUEUED;
+		}
+	} else if (io_u->ddir == DDIR_READ)
 		ret = preadv2(f->fd, iov, 1, io_u->offset, flags);
 	else if (io_u->ddir == DDIR_WRITE)
 		ret = pwritev2(f->fd, iov, 1, io_u->offset, flags);
@@ -180,6 +212,63 @@ static enum fio_q_status fio_pvsyncio2_queue(struct thread_data *td,
 
 	return fio_io_end(td, io_u, ret);
 }
+
+/*
+ * Runs on a nowait worker, the read that would have blocked the job
+ * thread blocks here instead.
+ */
+static int fio_pvsyncio2_work(struct submit_worker *sw,
+			      struct workqueue_work *work)
+{
+	struct io_u *io_u = container_of(work, struct io_u, work);
+	struct syncio_data *sd = sw->wq->td->io_ops_data;
+	struct iovec iov;
+	int ret;
+
+	iov.iov_base = io_u->xfer_buf;
+	iov.iov_len = io_u->xfer_buflen;
+
+	ret = preadv2(io_u->file->fd, &iov, 1, io_u->offset,
+			sd->rw_flags[io_u->index]);
+	if (ret != (int) io_u->xfer_buflen) {
+		if (ret >= 0)
+			io_u->resid = io_u->xfer_buflen - ret;
+		else
+			io_u->error = errno;
+	}
+
+	pthread_mutex_lock(&sd->done_lock);
+	sd->done[sd->nr_done++] = io_u;
+	pthread_cond_signal(&sd->done_cond);
+	pthread_mutex_unlock(&sd->done_lock);
+	return 0;
+}
+
+static int fio_pvsyncio2_getevents(struct thread_data *td, unsigned int min,
+				   unsigned int max,
+				   const struct timespec fio_unused *t)
+{
+	struct syncio_data *sd = td->io_ops_data;
+	unsigned int nr;
+
+	if (!sd->punted)
+		return 0;
+
+	pthread_mutex_lock(&sd->done_lock);
+	while (sd->nr_done < min && sd->nr_done < sd->punted)
+		pthread_cond_wait(&sd->done_cond, &sd->done_lock);
+
+	nr = min(sd->nr_done, max);
+	memcpy(sd->io_us, sd->done, nr * sizeof(struct io_u *));
+	sd->nr_done -= nr;
+	memmove(sd->done, sd->done + nr, sd->nr_done * sizeof(struct io_u *));
+	pthread_mutex_unlock(&sd->done_lock);
+
+	sd->punted -= nr;
+
+	dprint(FD_IO, "pvsyncio2_getevents: min=%d,max=%d: %d\n", min, max, nr);
+	return nr;
+}
 #endif
 
 static enum fio_q_status fio_psyncio_queue(struct thread_data *td,
@@ -412,6 +501,51 @@ static void fio_vsyncio_cleanup(struct thread_data *td)
 	}
 }
 
+#ifdef FIO_HAVE_PWRITEV2
+static struct workqueue_ops nowait_wq_ops = {
+	.fn		= fio_pvsyncio2_work,
+};
+
+static int fio_pvsyncio2_init(struct thread_data *td)
+{
+	struct psyncv2_options *o = td->eo;
+	struct syncio_data *sd;
+	unsigned int nr;
+	int ret;
+
+	ret = fio_vsyncio_init(td);
+	if (ret || !o->nowait_workers)
+		return ret;
+
+	/* offload workers queue io_us from the parent job's pool */
+	nr = td->parent ? td->parent->io_u_all.nr : td->o.iodepth;
+
+	sd = td->io_ops_data;
+	sd->done = calloc(td->o.iodepth, sizeof(struct io_u *));
+	sd->rw_flags = calloc(nr, sizeof(int));
+	pthread_mutex_init(&sd->done_lock, NULL);
+	pthread_cond_init(&sd->done_cond, NULL);
+
+	return workqueue_init(td, &sd->wq, &nowait_wq_ops, o->nowait_workers,
+				NULL);
+}
+
+static void fio_pvsyncio2_cleanup(struct thread_data *td)
+{
+	struct syncio_data *sd = td->io_ops_data;
+
+	if (sd && sd->done) {
+		workqueue_exit(&sd->wq);
+		pthread_cond_destroy(&sd->done_cond);
+		pthread_mutex_destroy(&sd->done_lock);
+		free(sd->done);
+		free(sd->rw_flags);
+	}
+
+	fio_vsyncio_cleanup(td);
+}
+#endif
+
 static struct ioengine_ops ioengine_rw = {
 	.name		= "sync",
 	.version	= FIO_IOOPS_VERSION,
@@ -466,9 +600,11 @@ static struct ioengine_ops ioengine_pvrw = {
 static struct ioengine_ops ioengine_pvrw2 = {
 	.name		= "pvsync2",
 	.version	= FIO_IOOPS_VERSION,
-	.init		= fio_vsyncio_init,
-	.cleanup	= fio_vsyncio_cleanup,
+	.init		= fio_pvsyncio2_init,
+	.cleanup	= fio_pvsyncio2_cleanup,
 	.queue		= fio_pvsyncio2_queue,
+	.getevents	= fio_pvsyncio2_getevents,
+	.event		= fio_vsyncio_event,
 	.open_file	= generic_open_file,
 	.close_file	= generic_close_file,
 	.get_file_size	= generic_get_file_size,
@@ -742,6 +742,24 @@ static enum fio_ddir get_rw_ddir(struct thread_data *td)
 	return td->rwmix_ddir;
 }
 
+/*
+ * Check if issuing one more write makes get_rw_ddir() schedule a sync
+ * right after it.
+ */
+static bool write_precedes_sync(struct thread_data *td)
+{
+	const uint64_t nr = td->io_issues[DDIR_WRITE] + 1;
+
+	if (td->o.fsync_blocks && !(nr % td->o.fsync_blocks))
+		return true;
+	if (td->o.fdatasync_blocks && !(nr % td->o.fdatasync_blocks))
+		return true;
+	if (td->sync_file_range_nr && !(nr % td->sync_file_range_nr))
+		return true;
+
+	return false;
+}
+
 static void set_rw_ddir(struct thread_data *td, struct io_u *io_u)
 {
 	enum fio_ddir ddir = get_rw_ddir(td);
@@ -761,6 +779,16 @@ static void set_rw_ddir(struct thread_data *td, struct io_u *io_u)
 	   !(td->io_issues[DDIR_WRITE] % td->o.barrier_blocks) &&
 	     td->io_issues[DDIR_WRITE])
 		io_u_set(td, io_u, IO_U_F_BARRIER);
+
+	/*
+	 * Tag the write that a sync will follow, so engines that can chain
+	 * requests get to see both before submitting. Only do so if there's
+	 * an io_u left for the sync, otherwise the write is committed alone
+	 * once the queue is full anyway.
+	 */
+	if (io_u->ddir == DDIR_WRITE && td->cur_depth < td->o.iodepth &&
+	    should_fsync(td) && write_precedes_sync(td))
+		io_u_set(td, io_u, IO_U_F_SYNC_LINK);
 }
 
 void put_file_log(struct thread_data *td, struct fio_file *f)
@@ -1541,7 +1569,8 @@ again:
 		assert(io_u->flags & IO_U_F_FREE);
 		io_u_clear(td, io_u, IO_U_F_FREE | IO_U_F_NO_FILE_PUT |
 				 IO_U_F_TRIMMED | IO_U_F_BARRIER |
-				 IO_U_F_VER_LIST | IO_U_F_PRIORITY);
+				 IO_U_F_VER_LIST | IO_U_F_PRIORITY |
+				 IO_U_F_SYNC_LINK);
 
 		io_u->error = 0;
 		io_u->acct_ddir = -1;
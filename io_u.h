@@ -25,6 +25,7 @@ enum {
 	IO_U_F_BARRIER		= 1 << 6,
 	IO_U_F_VER_LIST		= 1 << 7,
 	IO_U_F_PRIORITY		= 1 << 8,
+	IO_U_F_SYNC_LINK	= 1 << 9,	/* write is followed by a sync */
 };
 
 /*
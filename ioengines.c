@@ -386,7 +386,12 @@ enum fio_q_status td_io_queue(struct thread_data *td, struct io_u *io_u)
 		    (ddir_sync(io_u->ddir) && td->runstate != TD_FSYNCING))
 			td->ts.total_io_u[io_u->ddir]++;
 
-		if (td->io_u_queued >= td->o.iodepth_batch)
+		/*
+		 * Hold off a batch commit between a write and the sync
+		 * that follows it, so the engine can chain them.
+		 */
+		if (td->io_u_queued >= td->o.iodepth_batch &&
+		    !(io_u->flags & IO_U_F_SYNC_LINK))
 			td_io_commit(td);
 	}
 
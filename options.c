@@ -2025,6 +2025,16 @@ struct fio_option fio_options[FIO_MAX_OPTS] = {
 			  },
 		},
 	},
+	{
+		.name	= "io_submit_workers",
+		.lname	= "IO submit workers",
+		.type	= FIO_OPT_INT,
+		.off1	= offsetof(struct thread_options, io_submit_workers),
+		.help	= "Number of offload threads to spread the IO depth over",
+		.def	= "0",
+		.category = FIO_OPT_C_IO,
+		.group	= FIO_OPT_G_IO_BASIC,
+	},
 	{
 		.name	= "size",
 		.lname	= "Size",
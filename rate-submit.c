@@ -138,6 +138,31 @@ static void io_workqueue_free_fn(struct submit_worker *sw)
 	sw->priv = NULL;
 }
 
+/*
+ * With io_submit_workers set, the job's IO depth is spread over the workers
+ * and each one is pinned to a CPU of the job's cpumask, if it has one.
+ */
+static int io_workqueue_setup_worker(struct submit_worker *sw,
+				     struct thread_data *td)
+{
+	struct thread_data *parent = sw->wq->td;
+	unsigned int nr = sw->wq->max_workers;
+
+	td->o.iodepth = (parent->o.iodepth + nr - 1) / nr;
+
+#ifdef FIO_HAVE_CPU_AFFINITY
+	if (fio_option_is_set(&td->o, cpumask)) {
+		if (!fio_cpus_split(&td->o.cpumask, sw->index))
+			return 1;
+		if (fio_setaffinity(td->pid, td->o.cpumask) == -1) {
+			td_verror(parent, errno, "cpu_set_affinity");
+			return 1;
+		}
+	}
+#endif
+	return 0;
+}
+
 static int io_workqueue_init_worker_fn(struct submit_worker *sw)
 {
 	struct thread_data *parent = sw->wq->td;
@@ -147,6 +172,7 @@ static int io_workqueue_init_worker_fn(struct submit_worker *sw)
 	memcpy(&td->ts, &parent->ts, sizeof(td->ts));
 	td->o.uid = td->o.gid = -1U;
 	dup_files(td, parent);
+	td->files_index = parent->files_index;
 	td->eo = parent->eo;
 	fio_options_mem_dupe(td);
 
@@ -161,7 +187,12 @@ static int io_workqueue_init_worker_fn(struct submit_worker *sw)
 	INIT_FLIST_HEAD(&td->trim_list);
 	td->io_hist_tree = RB_ROOT;
 
-	td->o.iodepth = 1;
+	td->parent = parent;
+	if (!td->o.io_submit_workers)
+		td->o.iodepth = 1;
+	else if (io_workqueue_setup_worker(sw, td))
+		goto err_io_init;
+
 	if (td_io_init(td))
 		goto err_io_init;
 
@@ -174,7 +205,6 @@ static int io_workqueue_init_worker_fn(struct submit_worker *sw)
 
 	td_set_runstate(td, TD_RUNNING);
 	td->flags |= TD_F_CHILD | TD_F_NEED_LOCK;
-	td->parent = parent;
 	return 0;
 
 err_io_init:
@@ -280,10 +310,16 @@ static struct workqueue_ops rated_wq_ops = {
 
 int rate_submit_init(struct thread_data *td, struct sk_out *sk_out)
 {
+	unsigned int nr;
+
 	if (td->o.io_submit_mode != IO_MODE_OFFLOAD)
 		return 0;
 
-	return workqueue_init(td, &td->io_wq, &rated_wq_ops, td->o.iodepth, sk_out);
+	nr = td->o.iodepth;
+	if (td->o.io_submit_workers)
+		nr = min(td->o.io_submit_workers, td->o.iodepth);
+
+	return workqueue_init(td, &td->io_wq, &rated_wq_ops, nr, sk_out);
 }
 
 void rate_submit_exit(struct thread_data *td)
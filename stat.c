@@ -1131,6 +1131,20 @@ static void show_thread_status_normal(struct thread_stat *ts,
 					(unsigned long long) ts->drop_io_u[0],
 					(unsigned long long) ts->drop_io_u[1],
 					(unsigned long long) ts->drop_io_u[2]);
+	if (ts->nr_syscalls) {
+		uint64_t total = ddir_rw_sum(ts->total_io_u);
+
+		log_buf(out, "     syscalls  : total=%llu, per IO=%.2f\n",
+					(unsigned long long) ts->nr_syscalls,
+					total ? (double) ts->nr_syscalls / total : 0.0);
+	}
+	if (ts->zerocopy_bytes) {
+		char *zc = num2str(ts->zerocopy_bytes, ts->sig_figs, 1,
+					is_power_of_2(ts->kb_base), N2S_BYTE);
+
+		log_buf(out, "     zerocopy  : sent=%s\n", zc);
+		free(zc);
+	}
 	if (ts->continue_on_error) {
 		log_buf(out, "     errors    : total=%llu, first_error=%d/<%s>\n",
 					(unsigned long long)ts->total_err_count,
@@ -1565,6 +1579,8 @@ static struct json_object *show_thread_status_json(struct thread_stat *ts,
 	json_object_add_value_int(root, "ctx", ts->ctx);
 	json_object_add_value_int(root, "majf", ts->majf);
 	json_object_add_value_int(root, "minf", ts->minf);
+	json_object_add_value_int(root, "syscalls", ts->nr_syscalls);
+	json_object_add_value_int(root, "zerocopy_bytes", ts->zerocopy_bytes);
 
 	/* Calc % distribution of IO depths */
 	stat_calc_dist(ts->io_u_map, ddir_rw_sum(ts->total_io_u), io_u_dist);
@@ -1974,6 +1990,8 @@ void sum_thread_stats(struct thread_stat *dst, struct thread_stat *src,
 	dst->total_submit += src->total_submit;
 	dst->total_complete += src->total_complete;
 	dst->nr_zone_resets += src->nr_zone_resets;
+	dst->nr_syscalls += src->nr_syscalls;
+	dst->zerocopy_bytes += src->zerocopy_bytes;
 	dst->cachehit += src->cachehit;
 	dst->cachemiss += src->cachemiss;
 }
@@ -2674,6 +2692,8 @@ void reset_io_stats(struct thread_data *td)
 	ts->total_submit = 0;
 	ts->total_complete = 0;
 	ts->nr_zone_resets = 0;
+	ts->nr_syscalls = 0;
+	ts->zerocopy_bytes = 0;
 	ts->cachehit = ts->cachemiss = 0;
 }
 
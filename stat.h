@@ -226,6 +226,12 @@ struct thread_stat {
 	/* ZBD stats */
 	uint64_t nr_zone_resets;
 
+	/* system calls issued by the io engine to submit/reap IO */
+	uint64_t nr_syscalls;
+
+	/* bytes the io engine sent without copying them into the kernel */
+	uint64_t zerocopy_bytes;
+
 	uint64_t nr_block_infos;
 	uint32_t block_infos[MAX_NR_BLOCK_INFOS];
 
@@ -283,6 +283,7 @@ struct thread_options {
 	uint64_t ratemin[DDIR_RWDIR_CNT];
 	unsigned int ratecycle;
 	unsigned int io_submit_mode;
+	unsigned int io_submit_workers;
 	unsigned int rate_iops[DDIR_RWDIR_CNT];
 	unsigned int rate_iops_min[DDIR_RWDIR_CNT];
 	unsigned int rate_process;
@@ -608,6 +609,9 @@ struct thread_options_pack {
 	uint64_t offset_increment;
 	uint64_t number_ios;
 
+	uint32_t io_submit_workers;
+	uint32_t pad4;
+
 	uint64_t latency_target;
 	uint64_t latency_window;
 	uint64_t max_latency;